@@ -4,35 +4,61 @@
  * A kernel module to create a virtual device (vdev) driver that used 
  * to control mouse movement by keyboard keystroke (Ctrl + <symbol>)
  * 
- * There are 2 devices here. 
+ * There are 3 devices here. 
  *    1 char device to get config from user
  *    1 input device to control mouse movement
+ *    1 input device for absolute pointer commands
  * 
  * HOW IT WORKS?
  * 1. vdev gets the configuration from user through fops (by default "wsad")
  * 2. TOP-HALF
  *    After loaded to kernel, vdev will captures all the interrupt from i0842 
  *    controller, read the scancode on the data port (0x60) and put the it
- *    into the device data
+ *    into the device data. Bounces of the same key within the debounce
+ *    window are dropped here, before the tasklet gets scheduled. A key whose
+ *    state differs at the end of the window gets its settled state delivered
+ *    by a hrtimer
  * 3. BOTTOM-HALF
  *    The captured scancode will then be scheduled by a tasklet to handle
  *    the conversion to mouse movement (if the correct keys are pressed)
+ * 4. POINTER SCRIPT
+ *    User can also write a batch of timed pointer commands, vdev executes
+ *    them from a hrtimer and wakes up pollers (POLLPRI) once the script has completed
+ * 5. NETLINK
+ *    Config changes and periodic stats (events, drops, latency percentiles)
+ *    are multicast on the "VDEV" generic netlink family
+ * 6. EVENT RECORDS + INJECTION
+ *    Every captured scancode is recorded with its capture time for read().
+ *    User can inject scancodes which go through the same capture path,
+ *    without the debounce filter and with their own key buffer.
+ *    Config, injection and record retrieval are also available as
+ *    io_uring passthrough commands (uring_cmd) for batched submission
  */
 
 #include <asm/io.h>
 #include <linux/cdev.h> // for char device
 #include <linux/device.h> // for creating device file
 #include <linux/fs.h>
+#include <linux/hrtimer.h> // for pointer script
 #include <linux/init.h>
 #include <linux/input.h> // for input device
 #include <linux/interrupt.h>
+#include <linux/io_uring.h> // for uring_cmd
 #include <linux/ioport.h>
 #include <linux/kdev_t.h> // for creating device file
 #include <linux/kernel.h>
+#include <linux/kfifo.h> // for event records
+#include <linux/log2.h>
+#include <linux/ktime.h> // for capture timestamps
 #include <linux/module.h>
+#include <linux/poll.h>
 #include <linux/slab.h> // for kmalloc, kfree
 #include <linux/spinlock.h>
 #include <linux/uaccess.h> // for user access
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h> // for netlink stats
+#include <net/genetlink.h> // for netlink events
 
 #include "my_vdev.h"
 
@@ -44,7 +70,26 @@ static const struct file_operations vdev_fops = {
   .owner = THIS_MODULE,
   .open = vdev_open,
   .release = vdev_release,
+  .read = vdev_read,
   .write = vdev_write,
+  .poll = vdev_poll,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+  .uring_cmd = vdev_uring_cmd,
+#endif
+};
+
+static const struct genl_multicast_group vdev_genl_mcgrps[] = {
+  { .name = VDEV_GENL_MCGRP },
+};
+
+static struct genl_family vdev_genl_family = {
+  .name = VDEV_GENL_NAME,
+  .version = VDEV_GENL_VERSION,
+  .maxattr = VDEV_GENL_ATTR_MAX,
+  .module = THIS_MODULE,
+  .mcgrps = vdev_genl_mcgrps,
+  .n_mcgrps = ARRAY_SIZE(vdev_genl_mcgrps),
+  .mcast_bind = vdev_genl_mcast_bind,
 };
 
 /*********************************** TASKLET ************************************/
@@ -76,18 +121,17 @@ static int scancode_to_ascii(u8 scancode)
   return '?';
 }
 
-void mouse_tasklet_handler(unsigned long arg)
+static void handle_keys(struct vdev* data, const u8* keys)
 {
-  struct vdev* data = (struct vdev*)arg;
   int pressed;
 
-  //pr_info("VDEV: [0]: 0x%x, [1]: 0x%x", data->buf[0], data->buf[1]);
+  //pr_info("VDEV: [0]: 0x%x, [1]: 0x%x", keys[0], keys[1]);
 
-  pressed = is_key_pressed(data->buf[1]);
+  pressed = is_key_pressed(keys[1]);
 
   if (pressed) {
-    if (data->buf[0] == SCANCODE_LALT_MASK) {
-      char ch = scancode_to_ascii(data->buf[1]);
+    if (keys[0] == SCANCODE_LALT_MASK) {
+      char ch = scancode_to_ascii(keys[1]);
 
       if (ch == data->map[0]) {
         //pr_info("MOVE UP");
@@ -116,8 +160,8 @@ void mouse_tasklet_handler(unsigned long arg)
       }
     }
   } else {
-    if (data->buf[0] == SCANCODE_LALT_MASK) {
-      char ch = scancode_to_ascii(data->buf[1]);
+    if (keys[0] == SCANCODE_LALT_MASK) {
+      char ch = scancode_to_ascii(keys[1]);
 
       if (ch == data->map[4]) {
         //pr_info("BTN LEFT RELEASED");
@@ -132,6 +176,192 @@ void mouse_tasklet_handler(unsigned long arg)
   }
 }
 
+void mouse_tasklet_handler(unsigned long arg)
+{
+  struct vdev* data = (struct vdev*)arg;
+  ktime_t now = ktime_get();
+  s64 lat;
+  u8 keys[2];
+
+  spin_lock_irq(&data->lock);
+  lat = ktime_to_ns(ktime_sub(now, data->buf_ts));
+  data->lat_hist[lat > 0 ? min(ilog2(lat), LAT_BUCKETS - 1) : 0]++;
+  keys[0] = data->tasklet_keys[0];
+  keys[1] = data->tasklet_keys[1];
+  spin_unlock_irq(&data->lock);
+
+  handle_keys(data, keys);
+}
+
+/********************************** NETLINK *************************************/
+static u64 lat_percentile(const u32* hist, u64 total, int pct)
+{
+  u64 rank = DIV_ROUND_UP_ULL(total * pct, 100);
+  u64 seen = 0;
+  int i;
+
+  if (total == 0)
+    return 0;
+
+  // Report the upper bound of the bucket the rank falls into
+  for (i = 0; i < LAT_BUCKETS; i++) {
+    seen += hist[i];
+    if (seen >= rank)
+      break;
+  }
+  return 1ULL << (i + 1);
+}
+
+static void vdev_genl_send_config(struct vdev* data)
+{
+  struct sk_buff* skb;
+  void* hdr;
+
+  if (!genl_has_listeners(&vdev_genl_family, &init_net, 0))
+    return;
+
+  if ((skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL)) == NULL) {
+    pr_err("VDEV: genlmsg_new failed\n");
+    return;
+  }
+
+  hdr = genlmsg_put(skb, 0, 0, &vdev_genl_family, 0, VDEV_GENL_CMD_CONFIG);
+  if (hdr == NULL
+      || nla_put(skb, VDEV_GENL_ATTR_MAP, sizeof(data->map), data->map)
+      || nla_put_s32(skb, VDEV_GENL_ATTR_SPD, data->spd)
+      || nla_put_u32(skb, VDEV_GENL_ATTR_DBC, data->dbc)
+      || nla_put_u32(skb, VDEV_GENL_ATTR_NLI, data->nli)) {
+    pr_err("VDEV: genlmsg_put failed\n");
+    nlmsg_free(skb);
+    return;
+  }
+
+  genlmsg_end(skb, hdr);
+  genlmsg_multicast(&vdev_genl_family, skb, 0, 0, GFP_KERNEL);
+}
+
+static void vdev_genl_send_stats(struct vdev* data)
+{
+  struct sk_buff* skb;
+  void* hdr;
+  u32 hist[LAT_BUCKETS];
+  u64 events, drops, total = 0;
+  int i;
+
+  // Snapshot and reset the interval
+  spin_lock_irq(&data->lock);
+  events = data->events;
+  drops = data->dbc_dropped;
+  memcpy(hist, data->lat_hist, sizeof(hist));
+  memset(data->lat_hist, 0, sizeof(data->lat_hist));
+  spin_unlock_irq(&data->lock);
+
+  if (!genl_has_listeners(&vdev_genl_family, &init_net, 0))
+    return;
+
+  for (i = 0; i < LAT_BUCKETS; i++)
+    total += hist[i];
+
+  if ((skb = genlmsg_new(NLMSG_GOODSIZE, GFP_KERNEL)) == NULL) {
+    pr_err("VDEV: genlmsg_new failed\n");
+    return;
+  }
+
+  hdr = genlmsg_put(skb, 0, 0, &vdev_genl_family, 0, VDEV_GENL_CMD_STATS);
+  if (hdr == NULL
+      || nla_put_u64_64bit(skb, VDEV_GENL_ATTR_EVENTS, events, VDEV_GENL_ATTR_PAD)
+      || nla_put_u64_64bit(skb, VDEV_GENL_ATTR_DROPS, drops, VDEV_GENL_ATTR_PAD)
+      || nla_put_u64_64bit(skb, VDEV_GENL_ATTR_LAT_P50,
+          lat_percentile(hist, total, 50), VDEV_GENL_ATTR_PAD)
+      || nla_put_u64_64bit(skb, VDEV_GENL_ATTR_LAT_P90,
+          lat_percentile(hist, total, 90), VDEV_GENL_ATTR_PAD)
+      || nla_put_u64_64bit(skb, VDEV_GENL_ATTR_LAT_P99,
+          lat_percentile(hist, total, 99), VDEV_GENL_ATTR_PAD)) {
+    pr_err("VDEV: genlmsg_put failed\n");
+    nlmsg_free(skb);
+    return;
+  }
+
+  genlmsg_end(skb, hdr);
+  genlmsg_multicast(&vdev_genl_family, skb, 0, 0, GFP_KERNEL);
+}
+
+static int vdev_genl_mcast_bind(struct net* net, int group)
+{
+  struct vdev* data = &devs[0];
+  int nli = READ_ONCE(data->nli);
+
+  // No-op if the stats already run for another listener, otherwise start a
+  // fresh interval, samples taken while nobody listened are stale
+  if (nli > 0 && schedule_delayed_work(&data->stats_work, msecs_to_jiffies(nli))) {
+    spin_lock_irq(&data->lock);
+    memset(data->lat_hist, 0, sizeof(data->lat_hist));
+    spin_unlock_irq(&data->lock);
+  }
+  return 0;
+}
+
+void stats_work_handler(struct work_struct* work)
+{
+  struct vdev* data = container_of(to_delayed_work(work), struct vdev, stats_work);
+  int nli = READ_ONCE(data->nli);
+
+  vdev_genl_send_stats(data);
+
+  // Stops by itself once the last listener has left
+  if (nli > 0 && genl_has_listeners(&vdev_genl_family, &init_net, 0))
+    schedule_delayed_work(&data->stats_work, msecs_to_jiffies(nli));
+}
+
+/********************************** HRTIMER *************************************/
+static void run_pcmd(const struct vdev_pcmd* pcmd)
+{
+  switch (pcmd->type) {
+  case PCMD_REL:
+    input_report_rel(mouse_dev, REL_X, pcmd->x);
+    input_report_rel(mouse_dev, REL_Y, pcmd->y);
+    break;
+  case PCMD_ABS:
+    input_report_abs(abs_dev, ABS_X, pcmd->x);
+    input_report_abs(abs_dev, ABS_Y, pcmd->y);
+    input_sync(abs_dev);
+    return;
+  case PCMD_BTN:
+    input_report_key(mouse_dev, pcmd->x ? BTN_RIGHT : BTN_LEFT, pcmd->y);
+    break;
+  }
+  input_sync(mouse_dev);
+}
+
+enum hrtimer_restart script_timer_handler(struct hrtimer* timer)
+{
+  struct vdev* data = container_of(timer, struct vdev, script_timer);
+  struct vdev_pcmd* script = NULL;
+  ktime_t now = ktime_get();
+  ktime_t at;
+
+  spin_lock(&data->lock);
+  // Run every command that is due, then rearm for the next one
+  while (data->script_pos < data->script_len) {
+    at = ktime_add_us(data->script_start, data->script[data->script_pos].at_us);
+    if (ktime_after(at, now)) {
+      hrtimer_set_expires(timer, at);
+      spin_unlock(&data->lock);
+      return HRTIMER_RESTART;
+    }
+    run_pcmd(&data->script[data->script_pos++]);
+  }
+
+  script = data->script;
+  data->script = NULL;
+  data->script_done = 1;
+  spin_unlock(&data->lock);
+
+  kfree(script);
+  wake_up_interruptible(&data->script_wq);
+  return HRTIMER_NORESTART;
+}
+
 /********************************** INTERRUPT ***********************************/
 static inline u8 i8042_read_data(void)
 {
@@ -140,33 +370,172 @@ static inline u8 i8042_read_data(void)
   return val;
 }
 
-static void put_scancode(struct vdev* data, u8 scancode)
+static int is_key_bounce(struct vdev* data, u8 scancode, int ext, ktime_t now)
+{
+  // E0 keys have their own slots, e.g. Right Alt doesn't share one with Left Alt
+  int key = (scancode & ~SCANCODE_RELEASED_MASK) | (ext ? SCANCODE_EXT0_SLOT : 0);
+  ktime_t at = ktime_add_ms(data->key_ts[key], data->dbc);
+
+  data->key_raw[key] = is_key_pressed(scancode);
+
+  // Inside the window only the last seen state matters. If it differs from
+  // the accepted one, dbc_timer delivers it once the window expires so that
+  // a state change (e.g. a quick release) is never lost
+  if (ktime_before(now, at)) {
+    if (data->key_raw[key] != data->key_state[key]
+        && (!hrtimer_is_queued(&data->dbc_timer)
+            || ktime_before(at, hrtimer_get_expires(&data->dbc_timer))))
+      hrtimer_start(&data->dbc_timer, at, HRTIMER_MODE_ABS);
+    return 1;
+  }
+
+  data->key_state[key] = data->key_raw[key];
+  data->key_ts[key] = now;
+  return 0;
+}
+
+static void settle_key(struct vdev* data, int key, ktime_t now)
+{
+  u8 scancode = (key & ~SCANCODE_EXT0_SLOT)
+      | (data->key_raw[key] ? 0 : SCANCODE_RELEASED_MASK);
+
+  data->key_state[key] = data->key_raw[key];
+  data->key_ts[key] = now;
+
+  if (key & SCANCODE_EXT0_SLOT)
+    record_scancode(data, &data->kbd, SCANCODE_EXT0_PREFIX, now);
+  record_scancode(data, &data->kbd, scancode, now);
+  data->tasklet_keys[0] = data->kbd.buf[0];
+  data->tasklet_keys[1] = data->kbd.buf[1];
+  data->buf_ts = now;
+}
+
+enum hrtimer_restart dbc_timer_handler(struct hrtimer* timer)
+{
+  struct vdev* data = container_of(timer, struct vdev, dbc_timer);
+  ktime_t now = ktime_get();
+  ktime_t next = KTIME_MAX;
+  ktime_t at;
+  int settled = 0;
+  int key;
+  LIST_HEAD(parked);
+
+  spin_lock(&data->lock);
+  for (key = 0; key < SCANCODE_KEY_COUNT; key++) {
+    if (data->key_raw[key] == data->key_state[key])
+      continue;
+
+    at = ktime_add_ms(data->key_ts[key], data->dbc);
+    if (ktime_after(at, now)) {
+      if (ktime_before(at, next))
+        next = at;
+      continue;
+    }
+
+    settle_key(data, key, now);
+    settled = 1;
+  }
+  if (next != KTIME_MAX)
+    hrtimer_set_expires(timer, next);
+  if (settled)
+    list_splice_init(&data->evq_cmds, &parked);
+  spin_unlock(&data->lock);
+
+  if (settled) {
+    wake_up_interruptible(&data->evq_wq);
+    vdev_uring_complete_parked(&parked);
+    tasklet_schedule(mouse_tasklet);
+  }
+  return next != KTIME_MAX ? HRTIMER_RESTART : HRTIMER_NORESTART;
+}
+
+static void put_scancode(struct vdev* data, struct vdev_capture* cap, u8 scancode)
 {
   char ch = 0;
 
   ch = scancode_to_ascii(scancode);
 
-  if (data->buf[0] != SCANCODE_LALT_MASK
+  if (cap->buf[0] != SCANCODE_LALT_MASK
       || (ch == data->map[0] && ch == data->map[1]
           && ch == data->map[2] && ch == data->map[3])) {
-    data->buf[0] = data->buf[1];
+    cap->buf[0] = cap->buf[1];
   }
 
-  data->buf[1] = scancode;
-  //pr_info("VDEV: [0]: 0x%x, [1]: 0x%x", data->buf[0], data->buf[1]);
+  cap->buf[1] = scancode;
+  //pr_info("VDEV: [0]: 0x%x, [1]: 0x%x", cap->buf[0], cap->buf[1]);
+}
+
+static void record_scancode(struct vdev* data, struct vdev_capture* cap,
+    u8 scancode, ktime_t now)
+{
+  struct vdev_event ev = { .ts_ns = ktime_to_ns(now), .scancode = scancode };
+
+  data->events++;
+  put_scancode(data, cap, scancode);
+
+  if (kfifo_is_full(&data->evq))
+    kfifo_skip(&data->evq);
+  kfifo_put(&data->evq, ev);
+}
+
+static int capture_scancode(struct vdev* data, u8 scancode, ktime_t now,
+    int injected, u8* keys)
+{
+  struct vdev_capture* cap = injected ? &data->inj : &data->kbd;
+  unsigned long flags;
+  LIST_HEAD(parked);
+
+  spin_lock_irqsave(&data->lock, flags);
+  if (cap->ext1_left > 0 || scancode == SCANCODE_EXT1_PREFIX) {
+    // Every byte of a Pause sequence (E1 1D 45 E1 9D C5) bypasses the filter
+    cap->ext1_left = scancode == SCANCODE_EXT1_PREFIX ? 2 : cap->ext1_left - 1;
+  } else if (scancode == SCANCODE_EXT0_PREFIX) {
+    // Hold the prefix back until we know whether its key is a bounce
+    cap->ext0_pending = 1;
+    cap->ext0_ts = now;
+    spin_unlock_irqrestore(&data->lock, flags);
+    return 0;
+  } else if (!injected && is_key_bounce(data, scancode, cap->ext0_pending, now)) {
+    // Drop the bounce (and its prefix) without paying for a tasklet run.
+    // Injected input has no contact bounce and never touches the filter
+    cap->ext0_pending = 0;
+    data->dbc_dropped++;
+    spin_unlock_irqrestore(&data->lock, flags);
+    return 0;
+  }
+
+  if (cap->ext0_pending) {
+    record_scancode(data, cap, SCANCODE_EXT0_PREFIX, cap->ext0_ts);
+    cap->ext0_pending = 0;
+  }
+  record_scancode(data, cap, scancode, now);
+  if (keys != NULL) {
+    keys[0] = cap->buf[0];
+    keys[1] = cap->buf[1];
+  }
+  if (!injected) {
+    // Only keyboard keys wait for the tasklet and are latency samples
+    data->tasklet_keys[0] = cap->buf[0];
+    data->tasklet_keys[1] = cap->buf[1];
+    data->buf_ts = now;
+  }
+  list_splice_init(&data->evq_cmds, &parked);
+  spin_unlock_irqrestore(&data->lock, flags);
+
+  wake_up_interruptible(&data->evq_wq);
+  vdev_uring_complete_parked(&parked);
+  return 1;
 }
 
 irqreturn_t kbd_interrupt_handler(int irq_no, void* dev_id)
 {
   u8 scancode = i8042_read_data();
+  ktime_t now = ktime_get();
 
   struct vdev* data = (struct vdev*)dev_id;
 
-  spin_lock(&data->lock);
-  put_scancode(data, scancode);
-  spin_unlock(&data->lock);
-
-  tasklet_schedule(mouse_tasklet);
+  if (capture_scancode(data, scancode, now, 0, NULL))
+    tasklet_schedule(mouse_tasklet);
 
   // Report the interrupt as not handled
   // so that the original driver can
@@ -191,27 +560,241 @@ static int vdev_release(struct inode* inode, struct file* file)
   return 0;
 }
 
-// static ssize_t vdev_read(struct file* file, char __user* user_buffer,
-//     size_t count, loff_t* offset)
-// {
-//   struct vdev* data = (struct vdev*)file->private_data;
-//   size_t size = BUF_SIZE < count ? BUF_SIZE : count;
-//   char* buf;
+static ssize_t vdev_read_events(struct vdev* data, char __user* user_buffer,
+    size_t count)
+{
+  struct vdev_event* evs;
+  size_t len = min_t(size_t, count / sizeof(struct vdev_event), EVQ_SIZE);
+  unsigned int got;
 
-//   if ((buf = (char*)kmalloc(size, GFP_KERNEL)) == NULL) {
-//     pr_err("VDEV: kmalloc failed");
-//     return -EFAULT;
-//   }
+  if (len == 0)
+    return -EINVAL;
 
-//   snprintf(buf, size, "Config:\nMAP: %s\nSPD: %d\n",
-//       data->map,
-//       data->spd);
+  if ((evs = kmalloc_array(len, sizeof(struct vdev_event), GFP_KERNEL)) == NULL) {
+    pr_err("VDEV: kmalloc failed");
+    return -ENOMEM;
+  }
+
+  // Records are copied out under the lock, copy_to_user may sleep
+  spin_lock_irq(&data->lock);
+  got = kfifo_out(&data->evq, evs, len);
+  spin_unlock_irq(&data->lock);
+
+  if (got == 0) {
+    kfree(evs);
+    return -EAGAIN;
+  }
+
+  if (copy_to_user(user_buffer, evs, got * sizeof(struct vdev_event))) {
+    pr_err("VDEV: copy_to_user failed\n");
+    kfree(evs);
+    return -EFAULT;
+  }
+
+  kfree(evs);
+  return got * sizeof(struct vdev_event);
+}
+
+static ssize_t vdev_read(struct file* file, char __user* user_buffer,
+    size_t count, loff_t* offset)
+{
+  struct vdev* data = (struct vdev*)file->private_data;
+  ssize_t ret;
+
+  // Another reader may drain the records between wake up and read, retry
+  while ((ret = vdev_read_events(data, user_buffer, count)) == -EAGAIN) {
+    if (file->f_flags & O_NONBLOCK)
+      return -EAGAIN;
+    if (wait_event_interruptible(data->evq_wq, !kfifo_is_empty(&data->evq)))
+      return -ERESTARTSYS;
+  }
+
+  return ret;
+}
+
+static ssize_t vdev_inject(struct vdev* data, const char __user* user_buffer,
+    size_t count)
+{
+  u8* scancodes;
+  u8 keys[2];
+  size_t i;
+
+  if (count == 0 || count > INJ_MAX) {
+    pr_info("VDEV: User injection malformed");
+    return -EINVAL;
+  }
+
+  scancodes = memdup_user(user_buffer, count);
+  if (IS_ERR(scancodes)) {
+    pr_err("VDEV: memdup_user failed\n");
+    return PTR_ERR(scancodes);
+  }
+
+  // Handle keys per scancode so that no injected key is coalesced, with the
+  // snapshot taken at capture since another injection may change buf right after
+  for (i = 0; i < count; i++) {
+    if (capture_scancode(data, scancodes[i], ktime_get(), 1, keys))
+      handle_keys(data, keys);
+  }
+
+  kfree(scancodes);
+  return count;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+static void vdev_uring_events_cb(struct io_uring_cmd* ioucmd, unsigned int issue_flags)
+#else
+static void vdev_uring_events_cb(struct io_uring_cmd* ioucmd)
+#endif
+{
+  struct vdev* data = (struct vdev*)ioucmd->file->private_data;
+  struct vdev_uring_pdu* pdu = (struct vdev_uring_pdu*)ioucmd->pdu;
+  int ret;
+
+  // Runs in the submitter's task, so records can be copied to its buffer.
+  // Another consumer may have drained them meanwhile, then it's parked again
+  ret = vdev_uring_events(data, ioucmd, pdu->addr, pdu->len);
+  if (ret == -EIOCBQUEUED)
+    return;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+  io_uring_cmd_done(ioucmd, ret, 0, issue_flags);
+#else
+  io_uring_cmd_done(ioucmd, ret, 0);
+#endif
+}
+
+static int vdev_uring_events(struct vdev* data, struct io_uring_cmd* ioucmd,
+    void __user* addr, u32 len)
+{
+  struct vdev_uring_pdu* pdu = (struct vdev_uring_pdu*)ioucmd->pdu;
+  ssize_t ret;
+
+  BUILD_BUG_ON(sizeof(struct vdev_uring_pdu) > sizeof(ioucmd->pdu));
+
+  // -EAGAIN would make io_uring punt the command to a worker, park it
+  // instead until capture_scancode records an event
+  for (;;) {
+    ret = vdev_read_events(data, addr, len);
+    if (ret != -EAGAIN)
+      return ret;
+
+    spin_lock_irq(&data->lock);
+    if (kfifo_is_empty(&data->evq)) {
+      pdu->addr = addr;
+      pdu->len = len;
+      list_add_tail(&pdu->node, &data->evq_cmds);
+      spin_unlock_irq(&data->lock);
+      return -EIOCBQUEUED;
+    }
+    spin_unlock_irq(&data->lock);
+  }
+}
+
+static int vdev_uring_cmd(struct io_uring_cmd* ioucmd, unsigned int issue_flags)
+{
+  struct vdev* data = (struct vdev*)ioucmd->file->private_data;
+  const struct vdev_uring_cmd* cmd = ioucmd->cmd;
+  void __user* addr = u64_to_user_ptr(READ_ONCE(cmd->addr));
+  u32 len = READ_ONCE(cmd->len);
+
+  // Config and injection complete inline, the result goes to cqe->res
+  switch (ioucmd->cmd_op) {
+  case VDEV_URING_CONFIG:
+    return vdev_write(ioucmd->file, addr, len, NULL);
+  case VDEV_URING_INJECT:
+    return vdev_inject(data, addr, len);
+  case VDEV_URING_EVENTS:
+    return vdev_uring_events(data, ioucmd, addr, len);
+  default:
+    return -ENOTTY;
+  }
+}
+#endif
+
+static void vdev_uring_complete_parked(struct list_head* parked)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+  struct vdev_uring_pdu *pdu, *tmp;
+
+  // pdu is a byte array, so container_of() can't check its type
+  list_for_each_entry_safe(pdu, tmp, parked, node) {
+    list_del(&pdu->node);
+    io_uring_cmd_complete_in_task(
+        (struct io_uring_cmd*)((char*)pdu - offsetof(struct io_uring_cmd, pdu)),
+        vdev_uring_events_cb);
+  }
+#endif
+}
+
+static __poll_t vdev_poll(struct file* file, poll_table* wait)
+{
+  struct vdev* data = (struct vdev*)file->private_data;
+  __poll_t mask = 0;
 
-//   size = copy_to_user(user_buffer, buf, strlen(buf));
+  poll_wait(file, &data->evq_wq, wait);
+  poll_wait(file, &data->script_wq, wait);
 
-//   kfree(buf);
-//   return size;
-// }
+  spin_lock_irq(&data->lock);
+  if (!kfifo_is_empty(&data->evq))
+    mask |= EPOLLIN | EPOLLRDNORM;
+  if (data->script_done)
+    mask |= EPOLLPRI;
+  spin_unlock_irq(&data->lock);
+
+  return mask;
+}
+
+static ssize_t vdev_write_script(struct vdev* data,
+    const char __user* user_buffer, size_t count)
+{
+  struct vdev_pcmd* script;
+  int len = count / sizeof(struct vdev_pcmd);
+  int i;
+
+  if (len == 0 || len > PCMD_MAX || count % sizeof(struct vdev_pcmd)) {
+    pr_info("VDEV: User script malformed");
+    return -EINVAL;
+  }
+
+  script = memdup_user(user_buffer, count);
+  if (IS_ERR(script)) {
+    pr_err("VDEV: memdup_user failed\n");
+    return PTR_ERR(script);
+  }
+
+  for (i = 0; i < len; i++) {
+    if (script[i].type > PCMD_BTN
+        || (i > 0 && script[i].at_us < script[i - 1].at_us)
+        || (script[i].type == PCMD_ABS
+            && (script[i].x < 0 || script[i].x > PCMD_ABS_MAX
+                || script[i].y < 0 || script[i].y > PCMD_ABS_MAX))
+        || (script[i].type == PCMD_BTN
+            && (script[i].x < 0 || script[i].x > 1
+                || script[i].y < 0 || script[i].y > 1))) {
+      pr_info("VDEV: User script malformed");
+      kfree(script);
+      return -EINVAL;
+    }
+  }
+
+  spin_lock_irq(&data->lock);
+  if (data->script != NULL) {
+    spin_unlock_irq(&data->lock);
+    kfree(script);
+    return -EBUSY;
+  }
+  data->script = script;
+  data->script_len = len;
+  data->script_pos = 0;
+  data->script_done = 0;
+  data->script_start = ktime_get();
+  hrtimer_start(&data->script_timer,
+      ktime_add_us(data->script_start, script[0].at_us), HRTIMER_MODE_ABS);
+  spin_unlock_irq(&data->lock);
+
+  return count;
+}
 
 static ssize_t vdev_write(struct file* file, const char __user* user_buffer,
     size_t count, loff_t* offset)
@@ -220,8 +803,27 @@ static ssize_t vdev_write(struct file* file, const char __user* user_buffer,
   size_t size = BUF_SIZE < count ? BUF_SIZE : count;
   char* buf;
   char cmd;
+  int val;
+  int changed = 0;
+  ssize_t ret;
+
+  // Binary commands may exceed BUF_SIZE, pointer script: "3 " + vdev_pcmd[]
+  if (count > 2) {
+    if (get_user(cmd, user_buffer))
+      return -EFAULT;
+    if (cmd - '0' == CMD_SCRIPT) {
+      ret = vdev_write_script(data, user_buffer + 2, count - 2);
+      return ret < 0 ? ret : count;
+    }
+    // Injection is binary as well: "5 " + scancodes
+    if (cmd - '0' == CMD_INJ) {
+      ret = vdev_inject(data, user_buffer + 2, count - 2);
+      return ret < 0 ? ret : count;
+    }
+  }
 
-  if ((buf = (char*)kmalloc(size, GFP_KERNEL)) == NULL) {
+  // Full zeroed buffer + 1 so the argument is always a terminated string
+  if ((buf = (char*)kzalloc(BUF_SIZE + 1, GFP_KERNEL)) == NULL) {
     pr_err("VDEV: kmalloc failed");
     return -EFAULT;
   }
@@ -240,10 +842,42 @@ static ssize_t vdev_write(struct file* file, const char __user* user_buffer,
   case CMD_MAP:
     memcpy(&data->map, buf + 2, 6);
     // pr_info("VDEV: MAP: %s", data->map);
+    changed = 1;
     break;
   case CMD_SPD:
-    kstrtol(buf + 2, 10, (long int*)&data->spd);
+    if (kstrtoint(strim(buf + 2), 10, &val)) {
+      pr_info("VDEV: User config malformed");
+      break;
+    }
+    spin_lock_irq(&data->lock);
+    data->spd = val;
+    spin_unlock_irq(&data->lock);
     // pr_info("VDEV: SPD: %d", data->spd);
+    changed = 1;
+    break;
+  case CMD_DBC:
+    if (kstrtoint(strim(buf + 2), 10, &val) || val < 0 || val > DBC_MAX_MS) {
+      pr_info("VDEV: User config malformed");
+      break;
+    }
+    spin_lock_irq(&data->lock);
+    data->dbc = val;
+    spin_unlock_irq(&data->lock);
+    // pr_info("VDEV: DBC: %d", data->dbc);
+    changed = 1;
+    break;
+  case CMD_NLI:
+    if (kstrtoint(strim(buf + 2), 10, &val) || val < 0) {
+      pr_info("VDEV: User config malformed");
+      break;
+    }
+    WRITE_ONCE(data->nli, val);
+    if (val > 0 && genl_has_listeners(&vdev_genl_family, &init_net, 0))
+      mod_delayed_work(system_wq, &data->stats_work, msecs_to_jiffies(val));
+    else
+      cancel_delayed_work(&data->stats_work);
+    // pr_info("VDEV: NLI: %d", data->nli);
+    changed = 1;
     break;
   default:
     pr_info("VDEV: User config malformed");
@@ -251,6 +885,10 @@ static ssize_t vdev_write(struct file* file, const char __user* user_buffer,
   }
 
   kfree(buf);
+
+  if (changed)
+    vdev_genl_send_config(data);
+
   return size;
 }
 
@@ -290,6 +928,17 @@ static int __init vdev_init(void)
   devs[0].map[4] = 'j'; // BTNLEFT
   devs[0].map[5] = 'k'; // BTNRIGHT
   devs[0].spd = 10;
+  devs[0].dbc = DBC_DEFAULT_MS;
+  devs[0].nli = NLI_DEFAULT_MS;
+  INIT_DELAYED_WORK(&devs[0].stats_work, stats_work_handler);
+  INIT_KFIFO(devs[0].evq);
+  init_waitqueue_head(&devs[0].evq_wq);
+  INIT_LIST_HEAD(&devs[0].evq_cmds);
+  init_waitqueue_head(&devs[0].script_wq);
+  hrtimer_init(&devs[0].dbc_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  devs[0].dbc_timer.function = dbc_timer_handler;
+  hrtimer_init(&devs[0].script_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+  devs[0].script_timer.function = script_timer_handler;
 
   /* 4. Register IRQ handler for keyboard IRQ (IRQ1) */
   err = request_irq(
@@ -308,7 +957,7 @@ static int __init vdev_init(void)
   err = cdev_add(&devs[0].cdev, devnum, VDEV_DEV_COUNT);
   if (err != 0) {
     pr_err("VDEV: cdev_add failed: %d\n", err);
-    goto out_release_regions;
+    goto out_free_irq;
   }
 
   /* 6. Create struct class + device file */
@@ -354,17 +1003,63 @@ static int __init vdev_init(void)
     goto out_input_free_device;
   }
 
-  /* 10. Init tasklet mouse */
+  /* 10. Allocate + register absolute pointer device */
+  abs_dev = input_allocate_device();
+  if (abs_dev == NULL) {
+    err = -1;
+    pr_err("VDEV: input_dev registered failed\n");
+    goto out_input_unregister_device;
+  }
+
+  abs_dev->name = MODULE_NAME " ABS";
+  abs_dev->phys = MODULE_NAME;
+  abs_dev->id.bustype = BUS_VIRTUAL;
+  abs_dev->id.vendor = 0x0000;
+  abs_dev->id.product = 0x0000;
+  abs_dev->id.version = 0x0000;
+
+  set_bit(EV_ABS, abs_dev->evbit);
+  input_set_abs_params(abs_dev, ABS_X, 0, PCMD_ABS_MAX, 0, 0);
+  input_set_abs_params(abs_dev, ABS_Y, 0, PCMD_ABS_MAX, 0, 0);
+  set_bit(EV_KEY, abs_dev->evbit);
+  set_bit(BTN_LEFT, abs_dev->keybit); // so userspace classifies it as an absolute mouse
+
+  err = input_register_device(abs_dev);
+  if (err != 0) {
+    pr_err("VDEV: input_register_device failed\n");
+    goto out_abs_free_device;
+  }
+
+  /* 11. Register netlink family, stats start when someone joins */
+  err = genl_register_family(&vdev_genl_family);
+  if (err != 0) {
+    pr_err("VDEV: genl_register_family failed: %d\n", err);
+    goto out_abs_unregister_device;
+  }
+
+  /* 12. Init tasklet mouse */
   if ((mouse_tasklet = kmalloc(sizeof(struct tasklet_struct), GFP_KERNEL)) == NULL) {
     err = -1;
     pr_err("VDEV: kmalloc failed");
-    goto out_input_unregister_device;
+    goto out_genl_unregister;
   }
   tasklet_init(mouse_tasklet, mouse_tasklet_handler, (unsigned long)&devs[0]);
 
   pr_notice("VDEV: Driver %s loaded\n", MODULE_NAME);
   return 0;
 
+out_genl_unregister:
+  WRITE_ONCE(devs[0].nli, 0);
+  cancel_delayed_work_sync(&devs[0].stats_work);
+  genl_unregister_family(&vdev_genl_family);
+
+out_abs_unregister_device:
+  input_unregister_device(abs_dev);
+  abs_dev = NULL; // already freed by unregister
+
+out_abs_free_device:
+  input_free_device(abs_dev);
+
 out_input_unregister_device:
   input_unregister_device(mouse_dev);
 
@@ -380,6 +1075,10 @@ out_class_destroy:
 out_cdev_del:
   cdev_del(&devs[0].cdev);
 
+out_free_irq:
+  free_irq(I8042_KBD_IRQ, &devs[0]);
+  hrtimer_cancel(&devs[0].dbc_timer);
+
 out_release_regions:
   release_region(I8042_STATUS_REG + 1, 1);
   release_region(I8042_DATA_REG + 1, 1);
@@ -398,8 +1097,9 @@ static void __exit vdev_exit(void)
   /* 1. Delete char device from system*/
   cdev_del(&devs[0].cdev);
 
-  /* 2. Free irq */
+  /* 2. Free irq + stop debounce timer */
   free_irq(I8042_KBD_IRQ, &devs[0]);
+  hrtimer_cancel(&devs[0].dbc_timer);
 
   /* 3. Release keyboard I/O ports */
   release_region(I8042_STATUS_REG + 1, 1);
@@ -412,12 +1112,23 @@ static void __exit vdev_exit(void)
   device_destroy(dev_class, devnum);
   class_destroy(dev_class);
 
-  /* 6. Unregister input device*/
+  /* 6. Stop stats + unregister netlink family */
+  WRITE_ONCE(devs[0].nli, 0);
+  cancel_delayed_work_sync(&devs[0].stats_work);
+  genl_unregister_family(&vdev_genl_family);
+
+  /* 7. Stop pointer script */
+  hrtimer_cancel(&devs[0].script_timer);
+  kfree(devs[0].script);
+
+  /* 8. Unregister input devices*/
+  input_unregister_device(abs_dev);
   input_unregister_device(mouse_dev);
 
-  /* 7. Free input device */
+  /* 9. Free input device */
   input_free_device(mouse_dev);
 
+  pr_notice("VDEV: %lu key bounces filtered\n", devs[0].dbc_dropped);
   pr_notice("VDEV: Driver %s unloaded\n", MODULE_NAME);
 }
 
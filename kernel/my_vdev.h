@@ -1,6 +1,8 @@
 #ifndef __MY_VDEV_H__
 #define __MY_VDEV_H__
 
+#include "my_vdev_uapi.h"
+
 #define MODULE_NAME "VDEV"
 
 #define VDEV_MAJOR 42
@@ -13,24 +15,73 @@
 
 #define SCANCODE_RELEASED_MASK 0x80
 #define SCANCODE_LALT_MASK 0x38
+#define SCANCODE_EXT0_PREFIX 0xe0
+#define SCANCODE_EXT1_PREFIX 0xe1
+#define SCANCODE_KEY_COUNT 256 // plain keys + E0 keys
+#define SCANCODE_EXT0_SLOT 0x80 // debounce slots of E0 keys start here
+
+#define DBC_DEFAULT_MS 5
+#define DBC_MAX_MS 100 // settled states are delivered up to one window late
+#define NLI_DEFAULT_MS 1000
 
-#define CMD_MAP 0
-#define CMD_SPD 1
+#define LAT_BUCKETS 32 // log2 buckets of latency in ns
 
 #define BUF_SIZE 64
 
 /********************************** STRUCTURE ***********************************/
+struct vdev_capture { // Capture state of one scancode source (keyboard or injection)
+  u8 buf[2]; // buffer to store last 2 pressed key
+  int ext0_pending; // E0 prefix held back until its key is accepted
+  ktime_t ext0_ts; // capture time of the pending E0 prefix
+  int ext1_left; // bytes of an E1 (Pause) sequence still to come
+};
+
+struct vdev_uring_pdu { // Parked uring EVENTS command, lives in io_uring_cmd->pdu
+  struct list_head node;
+  void __user* addr;
+  u32 len;
+};
+
 static struct vdev { // Wrapper struct for char device
   struct cdev cdev;
   spinlock_t lock;
-  u8 buf[2]; // buffer to store last 2 pressed key
+  struct vdev_capture kbd; // keyboard IRQ
+  struct vdev_capture inj; // user injection, never mixed with real keys
+  u8 tasklet_keys[2]; // snapshot of kbd.buf taken at capture for the tasklet
   char map[6]; // map for mouse movement: UP, DOWN, LEFT, RIGHT, BTNLEFT, BTNRIGHT
 
   int spd; // mouse movement speed
+
+  int dbc; // debounce window in ms (0 disables the filter)
+  ktime_t key_ts[SCANCODE_KEY_COUNT]; // capture time of last accepted event per key
+  u8 key_state[SCANCODE_KEY_COUNT]; // last accepted state per key (1: pressed)
+  u8 key_raw[SCANCODE_KEY_COUNT]; // last seen state per key, delivered by dbc_timer if it differs
+  struct hrtimer dbc_timer; // fires when the window of a key with a pending state expires
+  unsigned long dbc_dropped; // number of bounces filtered
+
+  unsigned long events; // number of scancodes captured
+  ktime_t buf_ts; // capture time of tasklet_keys[1]
+  u32 lat_hist[LAT_BUCKETS]; // capture -> tasklet latency over the stats interval
+  int nli; // netlink stats interval in ms (0: disabled)
+  struct delayed_work stats_work; // only runs while someone listens
+
+  DECLARE_KFIFO(evq, struct vdev_event, EVQ_SIZE); // captured event records, oldest dropped when full
+  wait_queue_head_t evq_wq; // readers waiting for event records
+  struct list_head evq_cmds; // parked uring EVENTS commands waiting for records
+
+  struct hrtimer script_timer; // fires at the time of the next pointer command
+  struct vdev_pcmd* script; // running pointer script, NULL if idle
+  int script_len;
+  int script_pos; // next command to execute
+  ktime_t script_start;
+  int script_done; // set when the last submitted script has completed
+  wait_queue_head_t script_wq;
 } devs[1];
 
 static struct input_dev* mouse_dev;
 
+static struct input_dev* abs_dev; // absolute pointer for PCMD_ABS, kept apart from the relative mouse
+
 static struct class* dev_class;
 
 static struct tasklet_struct* mouse_tasklet;
@@ -46,21 +97,87 @@ static inline u8 i8042_read_data(void);
  */
 static int is_key_pressed(u8);
 
+/*
+ * Check if a scancode (E0 key if ext is set) captured at a given time is
+ * a bounce of the last accepted event of the same key
+ */
+static int is_key_bounce(struct vdev*, u8, int, ktime_t);
+
+/*
+ * Accept the last seen state of a key whose window has expired
+ */
+static void settle_key(struct vdev*, int, ktime_t);
+
+/*
+ * Debounce timer handler, deliver the settled state of keys
+ */
+enum hrtimer_restart dbc_timer_handler(struct hrtimer*);
+
+/*
+ * Put scancode to device data and event records
+ */
+static void record_scancode(struct vdev*, struct vdev_capture*, u8, ktime_t);
+
+/*
+ * Filter, record and put scancode to device data. Injected scancodes skip
+ * the debounce filter and use their own capture state.
+ * Return 1 if the scancode has to be processed, keys (if not NULL) then
+ * receives a snapshot of the source buf taken under the lock
+ */
+static int capture_scancode(struct vdev*, u8, ktime_t, int, u8*);
+
 /*
  * Put scancode to device data
  */
-static void put_scancode(struct vdev*, u8);
+static void put_scancode(struct vdev*, struct vdev_capture*, u8);
 
 /*
  * Return a character of a given scancode
  */
 static int scancode_to_ascii(u8);
 
+/*
+ * Convert the last 2 pressed keys to mouse movement
+ */
+static void handle_keys(struct vdev*, const u8*);
+
 /*
  * Mouse tasklet handler
  */
 void mouse_tasklet_handler(unsigned long);
 
+/*
+ * Return the latency value (ns) under which pct% of the histogram lies
+ */
+static u64 lat_percentile(const u32*, u64, int);
+
+/*
+ * Multicast current config / stats to netlink listeners
+ */
+static void vdev_genl_send_config(struct vdev*);
+static void vdev_genl_send_stats(struct vdev*);
+
+/*
+ * Start the stats when a listener joins, unless they already run
+ */
+static int vdev_genl_mcast_bind(struct net*, int);
+
+/*
+ * Stats work handler, reschedule itself every stats interval while
+ * someone listens
+ */
+void stats_work_handler(struct work_struct*);
+
+/*
+ * Execute a pointer command on mouse device (absolute device for PCMD_ABS)
+ */
+static void run_pcmd(const struct vdev_pcmd*);
+
+/*
+ * Pointer script timer handler
+ */
+enum hrtimer_restart script_timer_handler(struct hrtimer*);
+
 /*
  * Keyboard interrupt handler
  */
@@ -73,7 +190,23 @@ static int vdev_open(struct inode*, struct file*);
 static int vdev_release(struct inode*, struct file*);
 // User space -> Device: get config from user
 static ssize_t vdev_write(struct file*, const char __user*, size_t, loff_t*);
-// Device -> User space: send config to user
-// static ssize_t vdev_read(struct file*, const char __user*, size_t, loff_t*);
+// User space -> Device: submit a pointer script
+static ssize_t vdev_write_script(struct vdev*, const char __user*, size_t);
+// Notify user when event records are available (POLLIN)
+// or the pointer script has completed (POLLPRI)
+static __poll_t vdev_poll(struct file*, poll_table*);
+// Device -> User space: send captured event records to user
+static ssize_t vdev_read(struct file*, char __user*, size_t, loff_t*);
+static ssize_t vdev_read_events(struct vdev*, char __user*, size_t);
+// User space -> Device: inject scancodes as if captured from keyboard
+static ssize_t vdev_inject(struct vdev*, const char __user*, size_t);
+// Complete parked uring EVENTS commands once records are available
+static void vdev_uring_complete_parked(struct list_head*);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+// io_uring passthrough for config, injection and event records
+static int vdev_uring_cmd(struct io_uring_cmd*, unsigned int);
+// Retrieve event records, park the command if none is available
+static int vdev_uring_events(struct vdev*, struct io_uring_cmd*, void __user*, u32);
+#endif
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef __MY_VDEV_UAPI_H__
+#define __MY_VDEV_UAPI_H__
+
+/*
+ * Definitions shared between the driver and user space programs
+ */
+
+#include <linux/types.h>
+
+/*
+ * Commands written to /dev/VDEV as "<cmd> <arg>"
+ */
+#define CMD_MAP 0
+#define CMD_SPD 1
+#define CMD_DBC 2
+#define CMD_SCRIPT 3 // arg is an array of struct vdev_pcmd, completion is reported as POLLPRI
+#define CMD_NLI 4 // interval of netlink stats in ms (0: disabled)
+#define CMD_INJ 5 // arg is raw scancodes, processed as if captured from keyboard (no debounce)
+
+#define INJ_MAX 256 // max scancodes in one injection
+
+/*
+ * Event record, one per captured scancode, retrieved by read().
+ * read() blocks until a record is available unless O_NONBLOCK is set,
+ * poll() reports POLLIN while records are available
+ */
+#define EVQ_SIZE 256 // event records kept for read(), power of 2
+
+struct vdev_event {
+  __u64 ts_ns; // capture time, CLOCK_MONOTONIC
+  __u8 scancode;
+  __u8 pad[7];
+};
+
+/*
+ * io_uring passthrough (IORING_OP_URING_CMD), sqe->cmd_op is one of
+ *    VDEV_URING_CONFIG: same as write(), buffer is "<cmd> <arg>"
+ *    VDEV_URING_INJECT: buffer is raw scancodes, same as CMD_INJ
+ *    VDEV_URING_EVENTS: same as a blocking read(), buffer receives struct vdev_event[].
+ *                       If no record is available the command completes
+ *                       asynchronously as soon as one is captured
+ * and sqe->cmd holds a struct vdev_uring_cmd. cqe->res is the result of
+ * the equivalent syscall
+ */
+#define VDEV_URING_CONFIG 0
+#define VDEV_URING_INJECT 1
+#define VDEV_URING_EVENTS 2
+
+struct vdev_uring_cmd {
+  __u64 addr; // user buffer
+  __u32 len; // buffer length in bytes
+  __u32 pad;
+};
+
+/*
+ * Pointer command types
+ */
+#define PCMD_REL 0 // move pointer by (x, y)
+#define PCMD_ABS 1 // move pointer to (x, y), 0 <= x, y <= PCMD_ABS_MAX
+#define PCMD_BTN 2 // set button x (0: LEFT, 1: RIGHT) to state y (0: released, 1: pressed)
+
+#define PCMD_ABS_MAX 0xffff // range of absolute coordinates
+#define PCMD_MAX 256 // max commands in one script
+
+/*
+ * A timed pointer command. Commands of a script are executed in order,
+ * at_us is the offset from the submission of the script and must not decrease
+ */
+struct vdev_pcmd {
+  __u32 at_us;
+  __u32 type;
+  __s32 x;
+  __s32 y;
+};
+
+/*
+ * Generic netlink family, join VDEV_GENL_MCGRP to receive
+ *    VDEV_GENL_CMD_CONFIG on every config change
+ *    VDEV_GENL_CMD_STATS every stats interval while someone listens
+ * see user/listen.c for a listener
+ */
+#define VDEV_GENL_NAME "VDEV"
+#define VDEV_GENL_VERSION 1
+#define VDEV_GENL_MCGRP "events"
+
+enum {
+  VDEV_GENL_CMD_UNSPEC,
+  VDEV_GENL_CMD_CONFIG,
+  VDEV_GENL_CMD_STATS,
+  __VDEV_GENL_CMD_MAX,
+};
+#define VDEV_GENL_CMD_MAX (__VDEV_GENL_CMD_MAX - 1)
+
+enum {
+  VDEV_GENL_ATTR_UNSPEC,
+  VDEV_GENL_ATTR_PAD,
+  VDEV_GENL_ATTR_MAP, // binary, 6 chars: UP, DOWN, LEFT, RIGHT, BTNLEFT, BTNRIGHT
+  VDEV_GENL_ATTR_SPD, // s32
+  VDEV_GENL_ATTR_DBC, // u32, debounce window in ms
+  VDEV_GENL_ATTR_NLI, // u32, stats interval in ms
+  VDEV_GENL_ATTR_EVENTS, // u64, scancodes captured since load
+  VDEV_GENL_ATTR_DROPS, // u64, bounces filtered since load
+  VDEV_GENL_ATTR_LAT_P50, // u64, capture -> tasklet latency in ns over the interval
+  VDEV_GENL_ATTR_LAT_P90, // u64
+  VDEV_GENL_ATTR_LAT_P99, // u64
+  __VDEV_GENL_ATTR_MAX,
+};
+#define VDEV_GENL_ATTR_MAX (__VDEV_GENL_ATTR_MAX - 1)
+
+#endif
@@ -0,0 +1,252 @@
+#include <errno.h>
+#include <fcntl.h> // open
+#include <linux/io_uring.h> // io_uring_sqe, io_uring_cqe
+#include <stddef.h> // offsetof
+#include <stdio.h>
+#include <stdlib.h> // EXIT_FAILURE
+#include <string.h>
+#include <sys/mman.h> // mmap
+#include <sys/syscall.h> // io_uring_setup, io_uring_enter
+#include <time.h> // clock_gettime
+#include <unistd.h> // write, read, exit
+
+#include "../kernel/my_vdev_uapi.h"
+
+#define DEVICE_PATH "/dev/VDEV"
+
+#define QD 64 // ops per io_uring_enter
+#define OPS (QD * 1600) // ops per benchmark, multiple of QD
+#define EVS_PER_OP (EVQ_SIZE / QD) // records read per op, so a batch fits in the queue
+
+/*
+ * Compare ops/sec of the write paths against io_uring passthrough for
+ * config and injection, and records/sec of read() against uring for event
+ * records. Each uring batch is QD ops submitted and reaped with one
+ * io_uring_enter. The event queue is refilled before each timed batch
+ *
+ * NOTE: the device config can't be read back, so it is not restored.
+ * The bench leaves speed at 10
+ */
+
+struct ring {
+  int fd;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+};
+
+void error(char* msg)
+{
+  perror(msg);
+  exit(EXIT_FAILURE);
+}
+
+double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void ring_init(struct ring* r, unsigned entries)
+{
+  struct io_uring_params p;
+  char *sq, *cq;
+
+  memset(&p, 0, sizeof(p));
+  r->fd = syscall(__NR_io_uring_setup, entries, &p);
+  if (r->fd < 0)
+    error("io_uring_setup failed");
+
+  sq = mmap(NULL, p.sq_off.array + p.sq_entries * sizeof(unsigned),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+  cq = mmap(NULL, p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+  r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+  if (sq == MAP_FAILED || cq == MAP_FAILED || r->sqes == MAP_FAILED)
+    error("mmap failed");
+
+  r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+  r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+  r->sq_array = (unsigned*)(sq + p.sq_off.array);
+  r->cq_head = (unsigned*)(cq + p.cq_off.head);
+  r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+  r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+}
+
+// Submit n uring_cmd with the same payload and wait for all of them.
+// Return the sum of cqe->res
+long ring_run(struct ring* r, int fd, unsigned op, struct vdev_uring_cmd* cmd, unsigned n)
+{
+  unsigned tail = *r->sq_tail;
+  unsigned head;
+  unsigned i;
+  long sum = 0;
+
+  for (i = 0; i < n; i++, tail++) {
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = fd;
+    sqe->cmd_op = op;
+    memcpy((char*)sqe + offsetof(struct io_uring_sqe, cmd), cmd, sizeof(*cmd));
+    r->sq_array[idx] = idx;
+  }
+  __atomic_store_n(r->sq_tail, tail, __ATOMIC_RELEASE);
+
+  if (syscall(__NR_io_uring_enter, r->fd, n, n, IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+    error("io_uring_enter failed");
+
+  head = *r->cq_head;
+  while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+    struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+
+    if (cqe->res < 0) {
+      errno = -cqe->res;
+      error("uring_cmd failed");
+    }
+    sum += cqe->res;
+    head++;
+  }
+  __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+  return sum;
+}
+
+double bench_uring(struct ring* r, int fd, unsigned op, void* buf, size_t len)
+{
+  struct vdev_uring_cmd cmd = { .addr = (unsigned long)buf, .len = len };
+  double start = now();
+  int i;
+
+  for (i = 0; i < OPS; i += QD)
+    ring_run(r, fd, op, &cmd, QD);
+
+  return OPS / (now() - start);
+}
+
+double bench_write(int fd, void* buf, size_t len)
+{
+  double start = now();
+  int i;
+
+  for (i = 0; i < OPS; i++) {
+    if (write(fd, buf, len) < 0)
+      error("write failed");
+  }
+
+  return OPS / (now() - start);
+}
+
+// Empty the event queue, so that each refill lands as a full batch
+void drain_events(int fd)
+{
+  struct vdev_event evs[EVS_PER_OP];
+
+  while (read(fd, evs, sizeof(evs)) > 0)
+    ;
+  if (errno != EAGAIN)
+    error("read failed");
+}
+
+// Fill the event queue with one batch of records, outside the timed region
+void refill_events(int fd)
+{
+  char inj[2 + QD * EVS_PER_OP] = { '0' + CMD_INJ, ' ' };
+  unsigned i;
+
+  // Press + release 'z', not mapped to any mouse action
+  for (i = 2; i < sizeof(inj); i++)
+    inj[i] = i % 2 ? 0xac : 0x2c;
+
+  if (write(fd, inj, sizeof(inj)) < 0)
+    error("write failed");
+}
+
+// Event retrieval is reported in records/s, each op reads EVS_PER_OP records
+double bench_read_events(int fd)
+{
+  struct vdev_event evs[EVS_PER_OP];
+  double elapsed = 0, start;
+  long records = 0;
+  ssize_t ret;
+  int i, j;
+
+  for (i = 0; i < OPS; i += QD) {
+    refill_events(fd);
+
+    start = now();
+    for (j = 0; j < QD; j++) {
+      if ((ret = read(fd, evs, sizeof(evs))) < 0)
+        error("read failed");
+      records += ret / sizeof(struct vdev_event);
+    }
+    elapsed += now() - start;
+  }
+
+  return records / elapsed;
+}
+
+double bench_uring_events(struct ring* r, int fd)
+{
+  struct vdev_event evs[EVS_PER_OP];
+  struct vdev_uring_cmd cmd = { .addr = (unsigned long)evs, .len = sizeof(evs) };
+  double elapsed = 0, start;
+  long records = 0;
+  int i;
+
+  // All ops of a batch share the buffer, only the record count matters
+  for (i = 0; i < OPS; i += QD) {
+    refill_events(fd);
+
+    start = now();
+    records += ring_run(r, fd, VDEV_URING_EVENTS, &cmd, QD) / sizeof(struct vdev_event);
+    elapsed += now() - start;
+  }
+
+  return records / elapsed;
+}
+
+int main()
+{
+  struct ring r;
+  int fd;
+
+  // Non-blocking, read() must never wait in the timed region
+  fd = open(DEVICE_PATH, O_RDWR | O_NONBLOCK);
+  if (fd < 0)
+    error("Device path not found");
+
+  ring_init(&r, QD);
+
+  char spd[] = "1 10";
+  printf("config  write: %10.0f ops/s  uring: %10.0f ops/s\n",
+      bench_write(fd, spd, strlen(spd)),
+      bench_uring(&r, fd, VDEV_URING_CONFIG, spd, strlen(spd)));
+
+  // Press + release 'z', not mapped to any mouse action
+  char inj[] = { '0' + CMD_INJ, ' ', 0x2c, 0xac };
+  printf("inject  write: %10.0f ops/s  uring: %10.0f ops/s\n",
+      bench_write(fd, inj, sizeof(inj)),
+      bench_uring(&r, fd, VDEV_URING_INJECT, inj + 2, sizeof(inj) - 2));
+
+  // The inject bench left the queue full of records
+  drain_events(fd);
+  printf("events  read:  %10.0f rec/s  uring: %10.0f rec/s\n",
+      bench_read_events(fd),
+      bench_uring_events(&r, fd));
+
+  close(r.fd);
+  close(fd);
+
+  return 0;
+}
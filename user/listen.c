@@ -0,0 +1,177 @@
+#include <linux/genetlink.h> // genlmsghdr, CTRL_*
+#include <linux/netlink.h> // nlmsghdr, nlattr
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h> // EXIT_FAILURE
+#include <string.h>
+#include <sys/socket.h> // socket, send, recv, setsockopt
+#include <unistd.h> // close, exit
+
+#include "../kernel/my_vdev_uapi.h"
+
+#define MSG_SIZE 8192
+
+/*
+ * Join the VDEV generic netlink multicast group and print every
+ * config change and stats message
+ */
+
+#define GENLMSG_DATA(nh) ((char*)NLMSG_DATA(nh) + GENL_HDRLEN)
+#define GENLMSG_LEN(nh) ((int)(nh)->nlmsg_len - NLMSG_HDRLEN - GENL_HDRLEN)
+#define NLA_DATA(na) ((char*)(na) + NLA_HDRLEN)
+#define NLA_OK(na, len) ((len) >= (int)NLA_HDRLEN && (na)->nla_len >= NLA_HDRLEN \
+    && (na)->nla_len <= (len))
+#define NLA_NEXT(na, len) ((len) -= NLA_ALIGN((na)->nla_len), \
+    (struct nlattr*)((char*)(na) + NLA_ALIGN((na)->nla_len)))
+
+void error(char* msg)
+{
+  perror(msg);
+  exit(EXIT_FAILURE);
+}
+
+// Fill tb[type] with the attributes of a buffer, later ones win
+void parse_attrs(struct nlattr** tb, int max, struct nlattr* na, int len)
+{
+  memset(tb, 0, (max + 1) * sizeof(*tb));
+  for (; NLA_OK(na, len); na = NLA_NEXT(na, len)) {
+    int type = na->nla_type & NLA_TYPE_MASK;
+    if (type <= max)
+      tb[type] = na;
+  }
+}
+
+uint32_t nla_u32(struct nlattr* na)
+{
+  uint32_t val = 0;
+  if (na != NULL)
+    memcpy(&val, NLA_DATA(na), sizeof(val));
+  return val;
+}
+
+uint64_t nla_u64(struct nlattr* na)
+{
+  uint64_t val = 0;
+  if (na != NULL)
+    memcpy(&val, NLA_DATA(na), sizeof(val));
+  return val;
+}
+
+// Resolve family id and multicast group id of VDEV through nlctrl
+void resolve_family(int sock, int* family, int* group)
+{
+  static char buf[MSG_SIZE];
+  struct nlmsghdr* nh = (struct nlmsghdr*)buf;
+  struct genlmsghdr* gh;
+  struct nlattr* na;
+  struct nlattr* tb[CTRL_ATTR_MAX + 1];
+  struct nlattr* grp;
+  int len, rem;
+
+  memset(buf, 0, sizeof(buf));
+  nh->nlmsg_type = GENL_ID_CTRL;
+  nh->nlmsg_flags = NLM_F_REQUEST;
+  nh->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+  gh = (struct genlmsghdr*)NLMSG_DATA(nh);
+  gh->cmd = CTRL_CMD_GETFAMILY;
+  gh->version = 1;
+
+  na = (struct nlattr*)((char*)nh + NLMSG_ALIGN(nh->nlmsg_len));
+  na->nla_type = CTRL_ATTR_FAMILY_NAME;
+  na->nla_len = NLA_HDRLEN + sizeof(VDEV_GENL_NAME);
+  memcpy(NLA_DATA(na), VDEV_GENL_NAME, sizeof(VDEV_GENL_NAME));
+  nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + NLA_ALIGN(na->nla_len);
+
+  if (send(sock, buf, nh->nlmsg_len, 0) < 0)
+    error("send failed");
+
+  if ((len = recv(sock, buf, sizeof(buf), 0)) < 0)
+    error("recv failed");
+  if (!NLMSG_OK(nh, len) || nh->nlmsg_type == NLMSG_ERROR) {
+    fprintf(stderr, "Family %s not found, is the driver loaded?\n", VDEV_GENL_NAME);
+    exit(EXIT_FAILURE);
+  }
+
+  parse_attrs(tb, CTRL_ATTR_MAX, (struct nlattr*)GENLMSG_DATA(nh), GENLMSG_LEN(nh));
+  if (tb[CTRL_ATTR_FAMILY_ID] == NULL || tb[CTRL_ATTR_MCAST_GROUPS] == NULL) {
+    fprintf(stderr, "Malformed nlctrl reply\n");
+    exit(EXIT_FAILURE);
+  }
+  *family = *(uint16_t*)NLA_DATA(tb[CTRL_ATTR_FAMILY_ID]);
+
+  // Groups are nested twice: MCAST_GROUPS -> [i] -> NAME, ID
+  *group = -1;
+  grp = (struct nlattr*)NLA_DATA(tb[CTRL_ATTR_MCAST_GROUPS]);
+  rem = tb[CTRL_ATTR_MCAST_GROUPS]->nla_len - NLA_HDRLEN;
+  for (; NLA_OK(grp, rem); grp = NLA_NEXT(grp, rem)) {
+    struct nlattr* gtb[CTRL_ATTR_MCAST_GRP_MAX + 1];
+
+    parse_attrs(gtb, CTRL_ATTR_MCAST_GRP_MAX, (struct nlattr*)NLA_DATA(grp),
+        grp->nla_len - NLA_HDRLEN);
+    if (gtb[CTRL_ATTR_MCAST_GRP_NAME] != NULL && gtb[CTRL_ATTR_MCAST_GRP_ID] != NULL
+        && strcmp(NLA_DATA(gtb[CTRL_ATTR_MCAST_GRP_NAME]), VDEV_GENL_MCGRP) == 0)
+      *group = nla_u32(gtb[CTRL_ATTR_MCAST_GRP_ID]);
+  }
+  if (*group < 0) {
+    fprintf(stderr, "Group %s not found\n", VDEV_GENL_MCGRP);
+    exit(EXIT_FAILURE);
+  }
+}
+
+void print_msg(struct nlmsghdr* nh)
+{
+  struct genlmsghdr* gh = (struct genlmsghdr*)NLMSG_DATA(nh);
+  struct nlattr* tb[VDEV_GENL_ATTR_MAX + 1];
+
+  parse_attrs(tb, VDEV_GENL_ATTR_MAX, (struct nlattr*)GENLMSG_DATA(nh), GENLMSG_LEN(nh));
+
+  switch (gh->cmd) {
+  case VDEV_GENL_CMD_CONFIG:
+    printf("CONFIG map=%.6s spd=%d dbc=%ums nli=%ums\n",
+        tb[VDEV_GENL_ATTR_MAP] ? NLA_DATA(tb[VDEV_GENL_ATTR_MAP]) : "",
+        (int32_t)nla_u32(tb[VDEV_GENL_ATTR_SPD]),
+        nla_u32(tb[VDEV_GENL_ATTR_DBC]),
+        nla_u32(tb[VDEV_GENL_ATTR_NLI]));
+    break;
+  case VDEV_GENL_CMD_STATS:
+    printf("STATS events=%llu drops=%llu lat p50<%lluns p90<%lluns p99<%lluns\n",
+        (unsigned long long)nla_u64(tb[VDEV_GENL_ATTR_EVENTS]),
+        (unsigned long long)nla_u64(tb[VDEV_GENL_ATTR_DROPS]),
+        (unsigned long long)nla_u64(tb[VDEV_GENL_ATTR_LAT_P50]),
+        (unsigned long long)nla_u64(tb[VDEV_GENL_ATTR_LAT_P90]),
+        (unsigned long long)nla_u64(tb[VDEV_GENL_ATTR_LAT_P99]));
+    break;
+  }
+  fflush(stdout);
+}
+
+int main()
+{
+  static char buf[MSG_SIZE];
+  struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+  int sock, family, group, len;
+
+  sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+  if (sock < 0)
+    error("socket failed");
+  if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    error("bind failed");
+
+  resolve_family(sock, &family, &group);
+
+  if (setsockopt(sock, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &group, sizeof(group)) < 0)
+    error("Joining multicast group failed");
+
+  while ((len = recv(sock, buf, sizeof(buf), 0)) > 0) {
+    struct nlmsghdr* nh = (struct nlmsghdr*)buf;
+
+    for (; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+      if (nh->nlmsg_type == family)
+        print_msg(nh);
+    }
+  }
+
+  close(sock);
+
+  return 0;
+}
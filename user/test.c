@@ -1,9 +1,12 @@
 #include <fcntl.h> // open
+#include <poll.h> // poll
 #include <stdio.h>
 #include <stdlib.h> // EXIT_FAILURE
 #include <string.h>
 #include <unistd.h> // write, exit
 
+#include "../kernel/my_vdev_uapi.h"
+
 #define DEVICE_PATH "/dev/VDEV"
 
 void error(char* msg)
@@ -27,6 +30,30 @@ int main()
   char* spd = "1 20";
   write(fd, spd, strlen(spd));
 
+  char* dbc = "2 5";
+  write(fd, dbc, strlen(dbc));
+
+  char* nli = "4 1000";
+  write(fd, nli, strlen(nli));
+
+  // Pointer script: go to the center, click, then drag right
+  struct vdev_pcmd pcmds[] = {
+    { 0, PCMD_ABS, PCMD_ABS_MAX / 2, PCMD_ABS_MAX / 2 },
+    { 10000, PCMD_BTN, 0, 1 },
+    { 20000, PCMD_REL, 50, 0 },
+    { 30000, PCMD_REL, 50, 0 },
+    { 40000, PCMD_BTN, 0, 0 },
+  };
+  char script[2 + sizeof(pcmds)] = "3 ";
+  memcpy(script + 2, pcmds, sizeof(pcmds));
+  if (write(fd, script, sizeof(script)) < 0)
+    error("Pointer script rejected");
+
+  // Wait for the script to complete
+  struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+  if (poll(&pfd, 1, -1) < 0)
+    error("poll failed");
+
   close(fd);
 
   return 0;